@@ -1,5 +1,13 @@
 ﻿#include <iostream>
 #include <vector>
+#include <memory>
+#include <algorithm>
+#include <functional>
+#include <cmath>
+#include <thread>
+#include <mutex>
+#include <atomic>
+#include <condition_variable>
 #include <SFML/Graphics.hpp>
 #include <SFML/Audio.hpp>
 
@@ -25,6 +33,12 @@ const string KING_TEXTURE_WHITE = "шахматы/assets/w_King.png";
 const string KING_TEXTURE_BLACK = "шахматы/assets/b_King.png";
 const string BOARD_TEXTURE = "шахматы/assets/_composite.png";
 
+const int analysisLines = 3;
+const int analysisMaxDepth = 32;
+const int analysisKingScore = 100000;
+const int analysisInfinity = 1000000;
+const int analysisBarLimit = 1000;
+
 enum class PieceColor {
 	WHITE,
 	BLACK
@@ -453,6 +467,467 @@ public:
 		return Vector;
 	}
 };
+
+enum class AnalysisPieceType {
+	PAWN,
+	ROOK,
+	HORSE,
+	ELEPHANT,
+	QUEEN,
+	KING
+};
+
+// Lightweight copy of the game for the analysis thread: board holds indices into pieces (-1 = empty square),
+// so indices 0-15 are white and 16-31 are black exactly like in main.
+struct AnalysisPosition {
+	int board[fields][fields];
+	AnalysisPieceType types[32];
+	PieceColor colors[32];
+	PieceColor attacker;
+};
+
+struct AnalysisMove {
+	int from_col, from_row;
+	int to_col, to_row;
+};
+
+// One finished iteration of the search. Scores are from white's side.
+struct AnalysisSnapshot {
+	int generation;
+	int depth;
+	int count;
+	AnalysisMove moves[analysisLines];
+	int scores[analysisLines];
+};
+
+AnalysisPosition make_analysis_position(const vector<unique_ptr<ChessPiece>>& pieces, PieceColor attacker) {
+	AnalysisPosition position;
+	for (int row = 0; row < fields; row++) {
+		for (int col = 0; col < fields; col++) {
+			position.board[row][col] = -1;
+		}
+	}
+	for (int i = 0; i < pieces.size(); i++) {
+		position.colors[i] = pieces[i]->get_color();
+		position.types[i] = AnalysisPieceType::PAWN;
+		if (pieces[i]->get_x() < 0) {
+			continue;
+		}
+		if (dynamic_cast<Rook*>(pieces[i].get())) {
+			position.types[i] = AnalysisPieceType::ROOK;
+		}
+		else if (dynamic_cast<King*>(pieces[i].get())) {
+			position.types[i] = AnalysisPieceType::KING;
+		}
+		else if (dynamic_cast<Queen*>(pieces[i].get())) {
+			position.types[i] = AnalysisPieceType::QUEEN;
+		}
+		else if (dynamic_cast<Elephant*>(pieces[i].get())) {
+			position.types[i] = AnalysisPieceType::ELEPHANT;
+		}
+		else if (dynamic_cast<Horse*>(pieces[i].get())) {
+			position.types[i] = AnalysisPieceType::HORSE;
+		}
+		else if (!dynamic_cast<Pawn*>(pieces[i].get())) {
+			continue;
+		}
+		position.board[pieces[i]->get_y() / tileSize][pieces[i]->get_x() / tileSize] = i;
+	}
+	position.attacker = attacker;
+	return position;
+}
+
+bool same_analysis_position(const AnalysisPosition& a, const AnalysisPosition& b) {
+	if (a.attacker != b.attacker) {
+		return false;
+	}
+	for (int row = 0; row < fields; row++) {
+		for (int col = 0; col < fields; col++) {
+			if (a.board[row][col] != b.board[row][col]) {
+				return false;
+			}
+		}
+	}
+	return true;
+}
+
+int analysis_piece_value(AnalysisPieceType type) {
+	switch (type) {
+	case AnalysisPieceType::PAWN: return 100;
+	case AnalysisPieceType::HORSE: return 320;
+	case AnalysisPieceType::ELEPHANT: return 330;
+	case AnalysisPieceType::ROOK: return 500;
+	case AnalysisPieceType::QUEEN: return 900;
+	default: return 0;
+	}
+}
+
+int evaluate_analysis_position(const AnalysisPosition& position) {
+	int score = 0;
+	for (int row = 0; row < fields; row++) {
+		for (int col = 0; col < fields; col++) {
+			int index = position.board[row][col];
+			if (index == -1) {
+				continue;
+			}
+			AnalysisPieceType type = position.types[index];
+			int value = analysis_piece_value(type);
+			if (type != AnalysisPieceType::KING) {
+				value += 6 - (abs(2 * col - 7) + abs(2 * row - 7)) / 2;
+			}
+			if (type == AnalysisPieceType::PAWN) {
+				value += 5 * (position.colors[index] == PieceColor::WHITE ? 6 - row : row - 1);
+			}
+			score += position.colors[index] == PieceColor::WHITE ? value : -value;
+		}
+	}
+	return position.attacker == PieceColor::WHITE ? score : -score;
+}
+
+// Same movement rules as creature_points of the pieces: no check, the game ends when a king is taken.
+void generate_analysis_moves(const AnalysisPosition& position, vector<AnalysisMove>& moves, bool captures_only) {
+	static const int straight[4][2] = { {0, 1}, {0, -1}, {1, 0}, {-1, 0} };
+	static const int diagonal[4][2] = { {1, 1}, {-1, -1}, {1, -1}, {-1, 1} };
+	static const int horse[8][2] = { {1, -2}, {1, 2}, {-1, -2}, {-1, 2}, {2, -1}, {2, 1}, {-2, -1}, {-2, 1} };
+
+	moves.clear();
+	for (int row = 0; row < fields; row++) {
+		for (int col = 0; col < fields; col++) {
+			int index = position.board[row][col];
+			if (index == -1 || position.colors[index] != position.attacker) {
+				continue;
+			}
+			auto try_square = [&](int to_col, int to_row) {
+				if (to_col < 0 || to_col >= fields || to_row < 0 || to_row >= fields) {
+					return false;
+				}
+				int target = position.board[to_row][to_col];
+				if (target == -1) {
+					if (!captures_only) {
+						moves.push_back({ col, row, to_col, to_row });
+					}
+					return true;
+				}
+				if (position.colors[target] != position.attacker) {
+					moves.push_back({ col, row, to_col, to_row });
+				}
+				return false;
+			};
+			auto slide = [&](const int directions[][2], int count) {
+				for (int d = 0; d < count; d++) {
+					int to_col = col + directions[d][0];
+					int to_row = row + directions[d][1];
+					while (try_square(to_col, to_row)) {
+						to_col += directions[d][0];
+						to_row += directions[d][1];
+					}
+				}
+			};
+			auto step = [&](const int directions[][2], int count) {
+				for (int d = 0; d < count; d++) {
+					try_square(col + directions[d][0], row + directions[d][1]);
+				}
+			};
+
+			switch (position.types[index]) {
+			case AnalysisPieceType::PAWN: {
+				int move_direction = (position.attacker == PieceColor::WHITE) ? -1 : 1;
+				int start_rank = (position.attacker == PieceColor::WHITE) ? 6 : 1;
+				int forward_row = row + move_direction;
+				if (forward_row < 0 || forward_row >= fields) {
+					break;
+				}
+				if (!captures_only && position.board[forward_row][col] == -1) {
+					moves.push_back({ col, row, col, forward_row });
+					int double_forward_row = row + 2 * move_direction;
+					if (row == start_rank && position.board[double_forward_row][col] == -1) {
+						moves.push_back({ col, row, col, double_forward_row });
+					}
+				}
+				for (int side = -1; side <= 1; side += 2) {
+					int diag_col = col + side;
+					if (diag_col < 0 || diag_col >= fields) {
+						continue;
+					}
+					int target = position.board[forward_row][diag_col];
+					if (target != -1 && position.colors[target] != position.attacker) {
+						moves.push_back({ col, row, diag_col, forward_row });
+					}
+				}
+				break;
+			}
+			case AnalysisPieceType::ROOK:
+				slide(straight, 4);
+				break;
+			case AnalysisPieceType::ELEPHANT:
+				slide(diagonal, 4);
+				break;
+			case AnalysisPieceType::QUEEN:
+				slide(straight, 4);
+				slide(diagonal, 4);
+				break;
+			case AnalysisPieceType::HORSE:
+				step(horse, 8);
+				break;
+			case AnalysisPieceType::KING:
+				step(straight, 4);
+				step(diagonal, 4);
+				break;
+			}
+		}
+	}
+}
+
+// Captures go first, most valuable victim by least valuable attacker; taking the king beats everything.
+void order_analysis_moves(const AnalysisPosition& position, vector<AnalysisMove>& moves) {
+	auto key = [&](const AnalysisMove& move) {
+		int victim = position.board[move.to_row][move.to_col];
+		if (victim == -1) {
+			return 0;
+		}
+		if (position.types[victim] == AnalysisPieceType::KING) {
+			return analysisInfinity;
+		}
+		int attacker = position.board[move.from_row][move.from_col];
+		return 10 * analysis_piece_value(position.types[victim]) - analysis_piece_value(position.types[attacker]) / 10 + 1;
+	};
+	stable_sort(moves.begin(), moves.end(), [&](const AnalysisMove& a, const AnalysisMove& b) {
+		return key(a) > key(b);
+	});
+}
+
+bool analysis_move_takes_king(const AnalysisPosition& position, const AnalysisMove& move) {
+	int victim = position.board[move.to_row][move.to_col];
+	return victim != -1 && position.types[victim] == AnalysisPieceType::KING;
+}
+
+int make_analysis_move(AnalysisPosition& position, const AnalysisMove& move) {
+	int captured = position.board[move.to_row][move.to_col];
+	position.board[move.to_row][move.to_col] = position.board[move.from_row][move.from_col];
+	position.board[move.from_row][move.from_col] = -1;
+	position.attacker = (position.attacker == PieceColor::WHITE) ? PieceColor::BLACK : PieceColor::WHITE;
+	return captured;
+}
+
+void unmake_analysis_move(AnalysisPosition& position, const AnalysisMove& move, int captured) {
+	position.board[move.from_row][move.from_col] = position.board[move.to_row][move.to_col];
+	position.board[move.to_row][move.to_col] = captured;
+	position.attacker = (position.attacker == PieceColor::WHITE) ? PieceColor::BLACK : PieceColor::WHITE;
+}
+
+// Runs a multi-PV search on its own thread. Every finished depth is published into one of two snapshots:
+// the search only writes the back one and the renderer only copies the front one, so neither waits for the other.
+class Analyzer {
+private:
+	thread worker;
+	mutex position_mutex;
+	condition_variable position_changed;
+	AnalysisPosition pending_position;
+	bool has_position;
+	bool quit;
+	atomic<bool> stopping;
+	atomic<int> generation;
+	int searching_generation;
+
+	AnalysisSnapshot snapshots[2];
+	atomic<int> front;
+	atomic<bool> reading[2];
+
+	bool interrupted() {
+		return stopping.load(memory_order_relaxed) || generation.load(memory_order_relaxed) != searching_generation;
+	}
+
+	// Skips the swap if the renderer is still copying the back snapshot; the next depth will publish again.
+	bool publish(const AnalysisSnapshot& snapshot) {
+		int back = 1 - front.load();
+		if (reading[back].load()) {
+			return false;
+		}
+		snapshots[back] = snapshot;
+		front.store(back);
+		return true;
+	}
+
+	int search(AnalysisPosition& position, int depth, int alpha, int beta, int ply) {
+		if (interrupted()) {
+			return 0;
+		}
+		bool quiescence = depth <= 0;
+		int best = -analysisInfinity;
+		if (quiescence) {
+			best = evaluate_analysis_position(position);
+			if (best >= beta) {
+				return best;
+			}
+			alpha = max(alpha, best);
+		}
+
+		vector<AnalysisMove> moves;
+		generate_analysis_moves(position, moves, quiescence);
+		if (moves.empty()) {
+			return quiescence ? best : 0;
+		}
+		order_analysis_moves(position, moves);
+		for (const auto& move : moves) {
+			if (analysis_move_takes_king(position, move)) {
+				return analysisKingScore - ply;
+			}
+			int captured = make_analysis_move(position, move);
+			int score = -search(position, depth - 1, -beta, -alpha, ply + 1);
+			unmake_analysis_move(position, move, captured);
+			if (interrupted()) {
+				return 0;
+			}
+			if (score > best) {
+				best = score;
+			}
+			if (score > alpha) {
+				alpha = score;
+			}
+			if (alpha >= beta) {
+				break;
+			}
+		}
+		return best;
+	}
+
+	void analyse(AnalysisPosition position) {
+		vector<AnalysisMove> root_moves;
+		generate_analysis_moves(position, root_moves, false);
+		if (root_moves.empty()) {
+			return;
+		}
+		order_analysis_moves(position, root_moves);
+		vector<int> scores(root_moves.size(), 0);
+		AnalysisSnapshot snapshot;
+		bool published = true;
+
+		for (int depth = 1; depth <= analysisMaxDepth; depth++) {
+			for (int i = 0; i < root_moves.size(); i++) {
+				// Only the top lines need exact scores: the rest just have to prove they are worse than the last of them.
+				int floor = -analysisInfinity;
+				if (i >= analysisLines) {
+					vector<int> best(scores.begin(), scores.begin() + i);
+					nth_element(best.begin(), best.begin() + analysisLines - 1, best.end(), greater<int>());
+					floor = best[analysisLines - 1];
+				}
+				if (analysis_move_takes_king(position, root_moves[i])) {
+					scores[i] = analysisKingScore;
+					continue;
+				}
+				int captured = make_analysis_move(position, root_moves[i]);
+				scores[i] = -search(position, depth - 1, -analysisInfinity, -floor, 1);
+				unmake_analysis_move(position, root_moves[i], captured);
+				if (interrupted()) {
+					return;
+				}
+			}
+
+			vector<int> order(root_moves.size());
+			for (int i = 0; i < order.size(); i++) {
+				order[i] = i;
+			}
+			stable_sort(order.begin(), order.end(), [&](int a, int b) {
+				return scores[a] > scores[b];
+			});
+			vector<AnalysisMove> sorted_moves;
+			vector<int> sorted_scores;
+			for (int i : order) {
+				sorted_moves.push_back(root_moves[i]);
+				sorted_scores.push_back(scores[i]);
+			}
+			root_moves = sorted_moves;
+			scores = sorted_scores;
+
+			snapshot.generation = searching_generation;
+			snapshot.depth = depth;
+			snapshot.count = min<int>(analysisLines, root_moves.size());
+			for (int i = 0; i < snapshot.count; i++) {
+				snapshot.moves[i] = root_moves[i];
+				snapshot.scores[i] = position.attacker == PieceColor::WHITE ? scores[i] : -scores[i];
+			}
+			published = publish(snapshot);
+
+			if (abs(scores[0]) >= analysisKingScore - analysisMaxDepth) {
+				break;
+			}
+		}
+		while (!published && !interrupted()) {
+			this_thread::yield();
+			published = publish(snapshot);
+		}
+	}
+
+	void run() {
+		while (true) {
+			AnalysisPosition position;
+			{
+				unique_lock<mutex> lock(position_mutex);
+				position_changed.wait(lock, [&] {
+					return quit || (has_position && generation.load() != searching_generation);
+				});
+				if (quit) {
+					return;
+				}
+				position = pending_position;
+				searching_generation = generation.load();
+			}
+			analyse(position);
+		}
+	}
+
+public:
+	Analyzer() : has_position(false), quit(false), stopping(false), generation(0), searching_generation(0), front(0) {
+		for (int i = 0; i < 2; i++) {
+			snapshots[i].generation = -1;
+			snapshots[i].depth = 0;
+			snapshots[i].count = 0;
+			reading[i] = false;
+		}
+		worker = thread(&Analyzer::run, this);
+	}
+
+	void set_position(const AnalysisPosition& position) {
+		lock_guard<mutex> lock(position_mutex);
+		pending_position = position;
+		has_position = true;
+		generation++;
+		position_changed.notify_one();
+	}
+
+	void stop() {
+		lock_guard<mutex> lock(position_mutex);
+		has_position = false;
+		generation++;
+	}
+
+	// Copies the latest published snapshot; false if there is nothing yet for the current position.
+	bool read_snapshot(AnalysisSnapshot& snapshot) {
+		int current;
+		while (true) {
+			current = front.load();
+			reading[current].store(true);
+			if (front.load() == current) {
+				break;
+			}
+			reading[current].store(false);
+		}
+		snapshot = snapshots[current];
+		reading[current].store(false);
+		return snapshot.generation == generation.load() && snapshot.count > 0;
+	}
+
+	~Analyzer() {
+		{
+			lock_guard<mutex> lock(position_mutex);
+			quit = true;
+			stopping = true;
+			position_changed.notify_one();
+		}
+		worker.join();
+	}
+};
+
 class Board {
 private:
 	Texture boardTexture;
@@ -474,6 +949,52 @@ public:
 			window.draw(shariki[i]);
 		}
 	}
+
+	// Arrow for every candidate move, the best one brightest, with an evaluation bar on its target square.
+	void draw_analysis(RenderWindow& window, const AnalysisSnapshot& snapshot) {
+		const float thickness = 10.f;
+		const float head_size = 26.f;
+		for (int i = snapshot.count - 1; i >= 0; i--) {
+			const AnalysisMove& move = snapshot.moves[i];
+			Vector2f from(move.from_col * tileSize + tileSize / 2.f, move.from_row * tileSize + tileSize / 2.f);
+			Vector2f to(move.to_col * tileSize + tileSize / 2.f, move.to_row * tileSize + tileSize / 2.f);
+			float dx = to.x - from.x;
+			float dy = to.y - from.y;
+			float length = sqrt(dx * dx + dy * dy);
+			float angle = atan2(dy, dx) * 180.f / 3.14159265f;
+			Color color(40, 160, 60, 210 - 60 * i);
+
+			RectangleShape shaft(Vector2f(length - head_size, thickness));
+			shaft.setOrigin(0.f, thickness / 2.f);
+			shaft.setPosition(from);
+			shaft.setRotation(angle);
+			shaft.setFillColor(color);
+			window.draw(shaft);
+
+			ConvexShape head(3);
+			head.setPoint(0, Vector2f(0.f, 0.f));
+			head.setPoint(1, Vector2f(-head_size, -head_size / 2.f));
+			head.setPoint(2, Vector2f(-head_size, head_size / 2.f));
+			head.setPosition(to);
+			head.setRotation(angle);
+			head.setFillColor(color);
+			window.draw(head);
+
+			float share = 0.5f + max(-analysisBarLimit, min(analysisBarLimit, snapshot.scores[i])) / (2.f * analysisBarLimit);
+			Vector2f bar_size(tileSize - 20.f, 8.f);
+			Vector2f bar_position(move.to_col * tileSize + 10.f, move.to_row * tileSize + tileSize - 14.f);
+			RectangleShape bar(bar_size);
+			bar.setPosition(bar_position);
+			bar.setFillColor(Color(30, 30, 30, 220));
+			bar.setOutlineThickness(1.f);
+			bar.setOutlineColor(color);
+			window.draw(bar);
+			RectangleShape white_part(Vector2f(bar_size.x * share, bar_size.y));
+			white_part.setPosition(bar_position);
+			white_part.setFillColor(Color(235, 235, 235, 220));
+			window.draw(white_part);
+		}
+	}
 };
 
 
@@ -551,6 +1072,10 @@ int main() {
 	vector<vector<int>> vector_points;
 	bool flag = false;
 	PieceColor attacker = PieceColor::WHITE;
+	Analyzer analyzer;
+	bool analysis_mode = false;
+	bool analysis_sent = false;
+	AnalysisPosition analysed_position;
 
 	pieces.push_back(make_unique<Pawn>(15 + tileSize * 0, 15 + tileSize * 6, PieceColor::WHITE));//0
 	pieces.push_back(make_unique<Pawn>(15 + tileSize * 1, 15 + tileSize * 6, PieceColor::WHITE));//1
@@ -592,6 +1117,14 @@ int main() {
 			if (event.type == Event::Closed)
 				window.close();
 
+			if (event.type == Event::KeyPressed && event.key.code == Keyboard::A) {
+				analysis_mode = !analysis_mode;
+				analysis_sent = false;
+				if (!analysis_mode) {
+					analyzer.stop();
+				}
+			}
+
 			if (event.type == sf::Event::MouseButtonPressed && event.mouseButton.button == sf::Mouse::Left) {
 				Vector2i localPosition = Mouse::getPosition(window);
 				int position_mous_x = 15 + tileSize * (localPosition.x / tileSize);
@@ -646,11 +1179,25 @@ int main() {
 				vector_points.clear();
 			}
 		}
+		if (analysis_mode) {
+			AnalysisPosition position = make_analysis_position(pieces, attacker);
+			if (!analysis_sent || !same_analysis_position(position, analysed_position)) {
+				analyzer.set_position(position);
+				analysed_position = position;
+				analysis_sent = true;
+			}
+		}
 		window.clear();
 		board.draw(window);
 		for (const auto& piece : pieces) {
 			piece->draw(window);
 		}
+		if (analysis_mode) {
+			AnalysisSnapshot snapshot;
+			if (analyzer.read_snapshot(snapshot)) {
+				board.draw_analysis(window, snapshot);
+			}
+		}
 
 		render(vector_points,window,board);
 